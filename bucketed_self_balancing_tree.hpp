@@ -0,0 +1,968 @@
+#ifndef BUCKETED_SELF_BALANCING_TREE_HPP
+#define BUCKETED_SELF_BALANCING_TREE_HPP
+
+#include <iterator>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace MyDataStructures {
+    namespace bucket_detail {
+        // Counts how many keys of a sorted bucket are less than the needle,
+        // lane_mask(i) has to return one bit per lane for keys[i, i + Lanes).
+        // Since the bucket is sorted the first mask that isn't full ends the scan
+        template <std::size_t Lanes, typename MaskFn>
+        inline std::size_t count_less(std::size_t count, MaskFn lane_mask) {
+            const unsigned full_mask = (1u << Lanes) - 1;
+            std::size_t pos = 0;
+
+            for (std::size_t i = 0; i < count; i += Lanes) {
+                unsigned mask = lane_mask(i);
+
+                // Lanes past the end of the bucket hold stale keys
+                if (count - i < Lanes) {
+                    mask &= (1u << (count - i)) - 1;
+                }
+
+                pos += std::bitset<Lanes>(mask).count();
+                if (mask != full_mask) break;
+            }
+
+            return pos;
+        }
+
+        // Lower bound of key inside keys[0, count), the generic version is
+        // used for every key type we don't have a vectorized compare for
+        template <typename K, typename Enable = void>
+        struct bucket_search {
+            static inline std::size_t lower_bound(const K* keys, std::size_t count, K key) {
+                return std::lower_bound(keys, keys + count, key) - keys;
+            }
+        };
+
+#if defined(__SSE2__) || defined(_M_X64)
+        // 32 bit integers, unsigned keys get their sign bit flipped so the
+        // signed compare instructions order them correctly
+        template <typename K>
+        struct bucket_search<K, typename std::enable_if<std::is_integral<K>::value && sizeof(K) == 4>::type> {
+            static inline std::size_t lower_bound(const K* keys, std::size_t count, K key) {
+                const std::uint32_t bias = std::is_signed<K>::value ? 0u : 0x80000000u;
+                const std::int32_t k = static_cast<std::int32_t>(static_cast<std::uint32_t>(key) ^ bias);
+#if defined(__AVX2__)
+                const __m256i flip = _mm256_set1_epi32(static_cast<std::int32_t>(bias));
+                const __m256i needle = _mm256_set1_epi32(k);
+                return count_less<8>(count, [&](std::size_t i) {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+                    v = _mm256_xor_si256(v, flip);
+                    return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, v))));
+                });
+#else
+                const __m128i flip = _mm_set1_epi32(static_cast<std::int32_t>(bias));
+                const __m128i needle = _mm_set1_epi32(k);
+                return count_less<4>(count, [&](std::size_t i) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+                    v = _mm_xor_si128(v, flip);
+                    return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, v))));
+                });
+#endif
+            }
+        };
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+        // 64 bit integers, the 64 bit compare needs at least SSE4.2
+        template <typename K>
+        struct bucket_search<K, typename std::enable_if<std::is_integral<K>::value && sizeof(K) == 8>::type> {
+            static inline std::size_t lower_bound(const K* keys, std::size_t count, K key) {
+                const std::uint64_t bias = std::is_signed<K>::value ? 0u : 0x8000000000000000u;
+                const std::int64_t k = static_cast<std::int64_t>(static_cast<std::uint64_t>(key) ^ bias);
+#if defined(__AVX2__)
+                const __m256i flip = _mm256_set1_epi64x(static_cast<std::int64_t>(bias));
+                const __m256i needle = _mm256_set1_epi64x(k);
+                return count_less<4>(count, [&](std::size_t i) {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+                    v = _mm256_xor_si256(v, flip);
+                    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, v))));
+                });
+#else
+                const __m128i flip = _mm_set1_epi64x(static_cast<std::int64_t>(bias));
+                const __m128i needle = _mm_set1_epi64x(k);
+                return count_less<2>(count, [&](std::size_t i) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+                    v = _mm_xor_si128(v, flip);
+                    return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(needle, v))));
+                });
+#endif
+            }
+        };
+#endif
+
+        template <>
+        struct bucket_search<float> {
+            static inline std::size_t lower_bound(const float* keys, std::size_t count, float key) {
+#if defined(__AVX2__)
+                const __m256 needle = _mm256_set1_ps(key);
+                return count_less<8>(count, [&](std::size_t i) {
+                    return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(keys + i), needle, _CMP_LT_OQ)));
+                });
+#else
+                const __m128 needle = _mm_set1_ps(key);
+                return count_less<4>(count, [&](std::size_t i) {
+                    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys + i), needle)));
+                });
+#endif
+            }
+        };
+
+        template <>
+        struct bucket_search<double> {
+            static inline std::size_t lower_bound(const double* keys, std::size_t count, double key) {
+#if defined(__AVX2__)
+                const __m256d needle = _mm256_set1_pd(key);
+                return count_less<4>(count, [&](std::size_t i) {
+                    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(keys + i), needle, _CMP_LT_OQ)));
+                });
+#else
+                const __m128d needle = _mm_set1_pd(key);
+                return count_less<2>(count, [&](std::size_t i) {
+                    return static_cast<unsigned>(_mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(keys + i), needle)));
+                });
+#endif
+            }
+        };
+#endif
+    };
+
+    // Red-black tree whose nodes each hold a sorted bucket of up to
+    // BucketSize key/value pairs instead of a single pair. The balancing
+    // works on whole buckets, so the tree is roughly log2(BucketSize)
+    // levels shorter and the three node pointers are shared by the whole
+    // bucket. Only arithmetic keys are supported, which is what lets the
+    // search inside a bucket use SSE/AVX2 compares
+    template <typename K, typename V, std::size_t BucketSize = 32>
+    class bucketed_self_balancing_tree {
+        static_assert(std::is_arithmetic<K>::value, "bucketed_self_balancing_tree requires an arithmetic key type");
+        static_assert(BucketSize >= 16 && BucketSize <= 64 && BucketSize % 8 == 0,
+                      "BucketSize must be a multiple of 8 between 16 and 64");
+
+        enum class NodeColor {Red, Black};
+
+        // A bucket is merged with a neighbour once it drops below a quarter
+        // full, as long as the merged bucket is at most three quarters full
+        // so that an insert right after doesn't split it again
+        static constexpr std::size_t merge_threshold = BucketSize / 4;
+        static constexpr std::size_t merge_limit = BucketSize * 3 / 4;
+
+        // Every key in the left subtree is less than keys[0] and every key
+        // in the right subtree is greater than keys[count - 1]. Keys and
+        // values live in separate arrays so the keys can be loaded straight
+        // into vector registers
+        struct Node {
+            NodeColor color = NodeColor::Red;
+
+            Node* parent = nullptr;
+            Node* left_child = nullptr;
+            Node* right_child = nullptr;
+
+            std::size_t count = 0;
+            K keys[BucketSize] = {};
+            V values[BucketSize];
+        };
+
+        class BucketIterator {
+            // The pairs aren't stored anywhere, so operator-> has to hand
+            // out a pointer to a temporary it owns
+            template <typename R>
+            struct arrow_proxy {
+                R ref;
+                R* operator->() { return &ref; }
+            };
+
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type        = std::pair<const K, V>;
+            using difference_type   = std::ptrdiff_t;
+            using reference         = std::pair<const K&, V&>;
+            using const_reference   = std::pair<const K&, const V&>;
+            using pointer           = arrow_proxy<reference>;
+            using const_pointer     = arrow_proxy<const_reference>;
+
+            bool operator==(const BucketIterator& rhs) const {
+                return this->curr_node == rhs.curr_node && this->index == rhs.index;
+            }
+            bool operator!=(const BucketIterator& rhs) const {
+                return !(*this == rhs);
+            }
+
+            const_reference operator*() const {
+                return const_reference(curr_node->keys[index], curr_node->values[index]);
+            }
+
+            const_pointer operator->() const {
+                return const_pointer{**this};
+            }
+
+            reference operator*() {
+                return reference(curr_node->keys[index], curr_node->values[index]);
+            }
+
+            pointer operator->() {
+                return pointer{**this};
+            }
+
+            BucketIterator& operator++() {
+                // At end() we wrap around to begin(), same as self_balancing_tree
+                if (curr_node == nullptr) {
+                    if (tree->root == nullptr) {
+                        throw std::underflow_error("");
+                    }
+
+                    curr_node = minimum_leaf(tree->root);
+                    index = 0;
+                }
+                // Walk the current bucket before moving on to the next node
+                else if (index + 1 < curr_node->count) {
+                    index++;
+                } else {
+                    curr_node = successor(curr_node);
+                    index = 0;
+                }
+
+                return *this;
+            }
+
+            BucketIterator operator++(int) {
+                // Save the iterator before incrementing
+                BucketIterator tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            BucketIterator& operator--() {
+                // Mirrored version of the pre-increment operator
+                if (curr_node == nullptr) {
+                    if (tree->root == nullptr) {
+                        throw std::underflow_error("");
+                    }
+
+                    curr_node = maximum_leaf(tree->root);
+                    index = curr_node->count - 1;
+                } else if (index > 0) {
+                    index--;
+                } else {
+                    curr_node = predecessor(curr_node);
+                    index = (curr_node != nullptr) ? curr_node->count - 1 : 0;
+                }
+
+                return *this;
+            }
+
+            BucketIterator operator--(int) {
+                // Save the iterator before decrementing
+                BucketIterator tmp = *this;
+                --(*this);
+                return tmp;
+            }
+        private:
+            friend class bucketed_self_balancing_tree<K, V, BucketSize>;
+
+            Node* curr_node;
+            std::size_t index;
+            const bucketed_self_balancing_tree<K, V, BucketSize>* tree;
+
+            BucketIterator(Node* N, std::size_t I, const bucketed_self_balancing_tree<K, V, BucketSize>* T)
+                : curr_node(N), index(I), tree(T) {};
+        };
+
+        typedef BucketIterator iterator;
+        typedef const BucketIterator const_iterator;
+
+        std::size_t _size = 0;
+        Node* root = nullptr;
+
+        void destroy_helper(Node* N);
+        Node* clone_helper(const Node* N, Node* P);
+
+        static inline Node* minimum_leaf(Node* X);
+        static inline Node* maximum_leaf(Node* X);
+        static inline Node* successor(Node* X);
+        static inline Node* predecessor(Node* X);
+        static inline std::size_t bucket_lower_bound(const Node* X, const K& key);
+
+        inline Node* locate(const K& key, std::size_t& index) const;
+        inline Node* emplace_helper(const K& key, std::size_t& index, bool& inserted);
+        inline Node* split_node(Node* Z, std::size_t& index);
+        inline void merge_node(Node* Z);
+        inline void remove_node(Node* Z);
+
+        inline void left_rotate(Node* X);
+        inline void right_rotate(Node* X);
+        inline void repair_tree_after_insert(Node* Z);
+        inline void repair_tree_after_delete(Node* Z, Node* P, bool left_child);
+        inline void transplant(Node* X, Node* Y);
+        inline void RB_BSTDelete(Node* Z);
+
+        public:
+        bucketed_self_balancing_tree() {};
+        ~bucketed_self_balancing_tree() {
+            destroy_helper(root);
+            root = nullptr;
+        };
+
+        bucketed_self_balancing_tree(const bucketed_self_balancing_tree& T);
+        bucketed_self_balancing_tree(bucketed_self_balancing_tree&& T);
+        bucketed_self_balancing_tree& operator=(const bucketed_self_balancing_tree& T);
+        bucketed_self_balancing_tree& operator=(bucketed_self_balancing_tree&& T);
+
+        V& operator[](K elem_key);
+        V& at(K elem_key);
+        const V& at(K elem_key) const;
+
+        inline void insert(K elem_key, V elem_value);
+        inline void erase(const K& k);
+        inline void clear();
+        inline bool empty() const;
+        inline std::size_t size() const;
+
+        inline const_iterator find(const K& key) const;
+        inline const_iterator cbegin() const;
+        inline const_iterator cend() const;
+
+        inline iterator find(const K& key);
+        inline iterator begin();
+        inline iterator end();
+    };
+
+    template <typename K, typename V, std::size_t B>
+    bucketed_self_balancing_tree<K, V, B>::bucketed_self_balancing_tree(const bucketed_self_balancing_tree<K, V, B>& T) {
+        this->_size = T._size;
+        this->root = clone_helper(T.root, nullptr);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    bucketed_self_balancing_tree<K, V, B>::bucketed_self_balancing_tree(bucketed_self_balancing_tree<K, V, B>&& T) {
+        this->_size = T._size;
+        this->root = T.root;
+
+        T._size = 0;
+        T.root = nullptr;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    bucketed_self_balancing_tree<K, V, B>& bucketed_self_balancing_tree<K, V, B>::operator=(const bucketed_self_balancing_tree<K, V, B>& T) {
+        if (this == &T) return *this;
+
+        destroy_helper(this->root);
+
+        this->_size = T._size;
+        this->root = clone_helper(T.root, nullptr);
+
+        return *this;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    bucketed_self_balancing_tree<K, V, B>& bucketed_self_balancing_tree<K, V, B>::operator=(bucketed_self_balancing_tree<K, V, B>&& T) {
+        if (this == &T) return *this;
+
+        destroy_helper(this->root);
+
+        this->_size = T._size;
+        this->root = T.root;
+
+        T._size = 0;
+        T.root = nullptr;
+
+        return *this;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline std::size_t bucketed_self_balancing_tree<K, V, B>::bucket_lower_bound(const Node* X, const K& key) {
+        return bucket_detail::bucket_search<K>::lower_bound(X->keys, X->count, key);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::locate(const K& key, std::size_t& index) const {
+        Node* Z = root;
+
+        // Only the bucket bounds are compared on the way down, the
+        // bucket itself is searched once we know the key can only be here
+        while (Z != nullptr) {
+            if (key < Z->keys[0]) {
+                Z = Z->left_child;
+            } else if (key > Z->keys[Z->count - 1]) {
+                Z = Z->right_child;
+            } else {
+                index = bucket_lower_bound(Z, key);
+                return (Z->keys[index] == key) ? Z : nullptr;
+            }
+        }
+
+        return nullptr;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::const_iterator bucketed_self_balancing_tree<K, V, B>::find(const K& key) const {
+        std::size_t index = 0;
+        Node* Z = locate(key, index);
+
+        return BucketIterator(Z, Z != nullptr ? index : 0, this);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::iterator bucketed_self_balancing_tree<K, V, B>::find(const K& key) {
+        std::size_t index = 0;
+        Node* Z = locate(key, index);
+
+        return BucketIterator(Z, Z != nullptr ? index : 0, this);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::const_iterator bucketed_self_balancing_tree<K, V, B>::cbegin() const {
+        return BucketIterator(root != nullptr ? minimum_leaf(root) : nullptr, 0, this);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::const_iterator bucketed_self_balancing_tree<K, V, B>::cend() const {
+        return BucketIterator(nullptr, 0, this);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::iterator bucketed_self_balancing_tree<K, V, B>::begin() {
+        return BucketIterator(root != nullptr ? minimum_leaf(root) : nullptr, 0, this);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::iterator bucketed_self_balancing_tree<K, V, B>::end() {
+        return BucketIterator(nullptr, 0, this);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::minimum_leaf(Node* X) {
+        while (X->left_child != nullptr) {
+            X = X->left_child;
+        }
+        return X;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::maximum_leaf(Node* X) {
+        while (X->right_child != nullptr) {
+            X = X->right_child;
+        }
+        return X;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::successor(Node* X) {
+        if (X->right_child != nullptr) {
+            return minimum_leaf(X->right_child);
+        }
+
+        Node* N = X->parent;
+        while (N != nullptr && X == N->right_child) {
+            X = N;
+            N = N->parent;
+        }
+
+        return N;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::predecessor(Node* X) {
+        if (X->left_child != nullptr) {
+            return maximum_leaf(X->left_child);
+        }
+
+        Node* N = X->parent;
+        while (N != nullptr && X == N->left_child) {
+            X = N;
+            N = N->parent;
+        }
+
+        return N;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline std::size_t bucketed_self_balancing_tree<K, V, B>::size() const {
+        return _size;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline bool bucketed_self_balancing_tree<K, V, B>::empty() const {
+        return (_size == 0);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::emplace_helper(const K& key, std::size_t& index, bool& inserted) {
+        if (root == nullptr) {
+            root = new Node();
+            root->color = NodeColor::Black;
+            root->keys[0] = key;
+            root->count = 1;
+
+            _size++;
+            index = 0;
+            inserted = true;
+            return root;
+        }
+
+        // A key that falls outside every bucket on the path ends up at the
+        // front or back of the last bucket we visited
+        Node* Z = root;
+        while (true) {
+            if (key < Z->keys[0]) {
+                if (Z->left_child == nullptr) {
+                    index = 0;
+                    break;
+                }
+                Z = Z->left_child;
+            } else if (key > Z->keys[Z->count - 1]) {
+                if (Z->right_child == nullptr) {
+                    index = Z->count;
+                    break;
+                }
+                Z = Z->right_child;
+            } else {
+                index = bucket_lower_bound(Z, key);
+                if (Z->keys[index] == key) {
+                    inserted = false;
+                    return Z;
+                }
+                break;
+            }
+        }
+
+        if (Z->count == B) {
+            Z = split_node(Z, index);
+        }
+
+        for (std::size_t i = Z->count; i > index; i--) {
+            Z->keys[i] = Z->keys[i - 1];
+            Z->values[i] = std::move(Z->values[i - 1]);
+        }
+
+        Z->keys[index] = key;
+        Z->values[index] = V();
+        Z->count++;
+        _size++;
+
+        inserted = true;
+        return Z;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::split_node(Node* Z, std::size_t& index) {
+        Node* M = new Node();
+
+        // Appending past the end of a full bucket starts a fresh one
+        // instead of splitting, so ascending inserts leave full buckets
+        // behind. Otherwise the upper half moves into the new bucket
+        std::size_t split = (index == B) ? B : B / 2;
+
+        for (std::size_t i = split; i < B; i++) {
+            M->keys[i - split] = Z->keys[i];
+            M->values[i - split] = std::move(Z->values[i]);
+            Z->values[i] = V();
+        }
+        M->count = B - split;
+        Z->count = split;
+
+        // The new bucket has to be Z's in-order successor
+        if (Z->right_child == nullptr) {
+            Z->right_child = M;
+            M->parent = Z;
+        } else {
+            Node* S = minimum_leaf(Z->right_child);
+            S->left_child = M;
+            M->parent = S;
+        }
+
+        repair_tree_after_insert(M);
+
+        if (index == B || index > split) {
+            index -= split;
+            return M;
+        }
+
+        return Z;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    V& bucketed_self_balancing_tree<K, V, B>::operator[](K elem_key) {
+        std::size_t index;
+        bool inserted;
+        Node* Z = emplace_helper(elem_key, index, inserted);
+
+        return Z->values[index];
+    }
+
+    template <typename K, typename V, std::size_t B>
+    V& bucketed_self_balancing_tree<K, V, B>::at(K elem_key) {
+        std::size_t index = 0;
+        Node* Z = locate(elem_key, index);
+
+        if (Z == nullptr) {
+            throw std::out_of_range("Element not found in tree.");
+        }
+
+        return Z->values[index];
+    }
+
+    template <typename K, typename V, std::size_t B>
+    const V& bucketed_self_balancing_tree<K, V, B>::at(K elem_key) const {
+        std::size_t index = 0;
+        Node* Z = locate(elem_key, index);
+
+        if (Z == nullptr) {
+            throw std::out_of_range("Element not found in tree.");
+        }
+
+        return Z->values[index];
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::insert(K elem_key, V elem_value) {
+        std::size_t index;
+        bool inserted;
+        Node* Z = emplace_helper(elem_key, index, inserted);
+
+        // Like self_balancing_tree, inserting an existing key is a no-op
+        if (inserted) {
+            Z->values[index] = std::move(elem_value);
+        }
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::erase(const K& k) {
+        std::size_t index = 0;
+        Node* Z = locate(k, index);
+
+        if (Z == nullptr) return;
+
+        for (std::size_t i = index + 1; i < Z->count; i++) {
+            Z->keys[i - 1] = Z->keys[i];
+            Z->values[i - 1] = std::move(Z->values[i]);
+        }
+        Z->count--;
+        Z->values[Z->count] = V();
+        _size--;
+
+        if (Z->count == 0) {
+            remove_node(Z);
+        } else if (Z->count < merge_threshold) {
+            merge_node(Z);
+        }
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::merge_node(Node* Z) {
+        Node* S = successor(Z);
+
+        // Prefer pulling the next bucket into this one, otherwise
+        // try to fold this bucket into the previous one
+        if (S != nullptr && Z->count + S->count <= merge_limit) {
+            for (std::size_t i = 0; i < S->count; i++) {
+                Z->keys[Z->count + i] = S->keys[i];
+                Z->values[Z->count + i] = std::move(S->values[i]);
+            }
+            Z->count += S->count;
+            S->count = 0;
+
+            remove_node(S);
+            return;
+        }
+
+        Node* P = predecessor(Z);
+
+        if (P != nullptr && P->count + Z->count <= merge_limit) {
+            for (std::size_t i = 0; i < Z->count; i++) {
+                P->keys[P->count + i] = Z->keys[i];
+                P->values[P->count + i] = std::move(Z->values[i]);
+            }
+            P->count += Z->count;
+            Z->count = 0;
+
+            remove_node(Z);
+        }
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::remove_node(Node* Z) {
+        // Last bucket in the tree
+        if (Z == root && Z->left_child == nullptr && Z->right_child == nullptr) {
+            delete Z;
+            root = nullptr;
+            return;
+        }
+
+        RB_BSTDelete(Z);
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::transplant(Node* X, Node* Y) {
+        if (X->parent == nullptr) {
+            root = Y;
+        } else if (X == X->parent->left_child) {
+            X->parent->left_child = Y;
+        } else {
+            X->parent->right_child = Y;
+        }
+        if (Y != nullptr) Y->parent = X->parent;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    void bucketed_self_balancing_tree<K, V, B>::destroy_helper(Node* N) {
+        if (N == nullptr)
+            return;
+
+        destroy_helper(N->left_child);
+        destroy_helper(N->right_child);
+
+        delete N;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    typename bucketed_self_balancing_tree<K, V, B>::Node* bucketed_self_balancing_tree<K, V, B>::clone_helper(const Node* N, Node* P) {
+        if (N == nullptr)
+            return nullptr;
+
+        Node* Z = new Node();
+        for (std::size_t i = 0; i < N->count; i++) {
+            Z->keys[i] = N->keys[i];
+            Z->values[i] = N->values[i];
+        }
+        Z->count = N->count;
+        Z->color = N->color;
+        Z->parent = P;
+
+        Z->left_child = clone_helper(N->left_child, Z);
+        Z->right_child = clone_helper(N->right_child, Z);
+
+        return Z;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::RB_BSTDelete(Node* Z) {
+        Node* X;
+        Node* Y;
+        Node* P;
+        bool left_child;
+
+        if (Z->left_child == nullptr || Z->right_child == nullptr) {
+            Y = Z;
+        } else {
+            Y = minimum_leaf(Z->right_child);
+        }
+
+        if (Y->left_child != nullptr) {
+            X = Y->left_child;
+        } else {
+            X = Y->right_child;
+        }
+
+        P = Y->parent;
+
+        if (Y->parent && Y == Y->parent->left_child) left_child = true;
+        else left_child = false;
+
+        transplant(Y, X);
+
+        // The successor's bucket takes the place of Z's, Z itself is empty
+        if (Y != Z) {
+            for (std::size_t i = 0; i < Y->count; i++) {
+                Z->keys[i] = Y->keys[i];
+                Z->values[i] = std::move(Y->values[i]);
+            }
+            for (std::size_t i = Y->count; i < Z->count; i++) {
+                Z->values[i] = V();
+            }
+            Z->count = Y->count;
+        }
+
+        if (Y->color == NodeColor::Black) {
+            repair_tree_after_delete(X, P, left_child);
+        }
+
+        delete Y;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::clear() {
+        destroy_helper(root);
+        root = nullptr;
+        _size = 0;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::left_rotate(Node* X) {
+        Node* Y = X->right_child;
+        X->right_child = Y->left_child;
+        if (Y->left_child != nullptr) {
+            Y->left_child->parent = X;
+        }
+        Y->parent = X->parent;
+        if (X->parent == nullptr) {
+            root = Y;
+        } else if (X == X->parent->left_child) {
+            X->parent->left_child = Y;
+        } else {
+            X->parent->right_child = Y;
+        }
+        Y->left_child = X;
+        X->parent = Y;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::right_rotate(Node* X) {
+        Node* Y = X->left_child;
+        X->left_child = Y->right_child;
+        if (Y->right_child != nullptr) {
+            Y->right_child->parent = X;
+        }
+        Y->parent = X->parent;
+        if (X->parent == nullptr) {
+            root = Y;
+        } else if (X == X->parent->right_child) {
+            X->parent->right_child = Y;
+        } else {
+            X->parent->left_child = Y;
+        }
+        Y->right_child = X;
+        X->parent = Y;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::repair_tree_after_delete(Node* Z, Node* P, bool left_child) {
+        Node* W;
+        while (Z != root && (Z == nullptr || Z->color == NodeColor::Black)) {
+            if (left_child) {
+                W = P->right_child;
+                if (W != nullptr && W->color == NodeColor::Red) {
+                    W->color = NodeColor::Black;
+                    P->color = NodeColor::Red;
+                    left_rotate(P);
+                    W = P->right_child;
+                }
+
+                bool is_left_black = W->left_child == nullptr || W->left_child->color == NodeColor::Black;
+                bool is_right_black = W->right_child == nullptr || W->right_child->color == NodeColor::Black;
+
+                if (is_left_black && is_right_black) {
+                    W->color = NodeColor::Red;
+                    Z = P;
+                    P = P->parent;
+                    left_child = (P != nullptr && P->left_child == Z);
+                } else {
+                    if (is_right_black) {
+                        W->left_child->color = NodeColor::Black;
+                        W->color = NodeColor::Red;
+                        right_rotate(W);
+                        W = P->right_child;
+                    }
+
+                    W->color = P->color;
+                    P->color = NodeColor::Black;
+                    if (W->right_child != nullptr) {
+                        W->right_child->color = NodeColor::Black;
+                    }
+                    left_rotate(P);
+                    Z = root;
+                }
+            } else {
+                W = P->left_child;
+                if (W != nullptr && W->color == NodeColor::Red) {
+                    W->color = NodeColor::Black;
+                    P->color = NodeColor::Red;
+                    right_rotate(P);
+                    W = P->left_child;
+                }
+
+                bool is_left_black = W->left_child == nullptr || W->left_child->color == NodeColor::Black;
+                bool is_right_black = W->right_child == nullptr || W->right_child->color == NodeColor::Black;
+
+                if (is_left_black && is_right_black) {
+                    W->color = NodeColor::Red;
+                    Z = P;
+                    P = P->parent;
+                    left_child = (P != nullptr && P->left_child == Z);
+                } else {
+                    if (is_left_black) {
+                        W->right_child->color = NodeColor::Black;
+                        W->color = NodeColor::Red;
+                        left_rotate(W);
+                        W = P->left_child;
+                    }
+
+                    W->color = P->color;
+                    P->color = NodeColor::Black;
+                    if (W->left_child != nullptr) {
+                        W->left_child->color = NodeColor::Black;
+                    }
+                    right_rotate(P);
+                    Z = root;
+                }
+            }
+        }
+
+        Z->color = NodeColor::Black;
+    }
+
+    template <typename K, typename V, std::size_t B>
+    inline void bucketed_self_balancing_tree<K, V, B>::repair_tree_after_insert(Node* Z) {
+        while (Z != root && Z->parent->color == NodeColor::Red) {
+            Node* Y;
+            if (Z->parent == Z->parent->parent->left_child) {
+                Y = Z->parent->parent->right_child;
+
+                if (Y != nullptr && Y->color == NodeColor::Red) {
+                    Z->parent->color = NodeColor::Black;
+                    Y->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    Z = Z->parent->parent;
+                } else {
+                    if (Z == Z->parent->right_child) {
+                        Z = Z->parent;
+                        left_rotate(Z);
+                    }
+                    Z->parent->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    right_rotate(Z->parent->parent);
+                }
+
+            } else {
+                Y = Z->parent->parent->left_child;
+
+                if (Y != nullptr && Y->color == NodeColor::Red) {
+                    Z->parent->color = NodeColor::Black;
+                    Y->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    Z = Z->parent->parent;
+                } else {
+                    if (Z == Z->parent->left_child) {
+                        Z = Z->parent;
+                        right_rotate(Z);
+                    }
+                    Z->parent->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    left_rotate(Z->parent->parent);
+                }
+
+            }
+        }
+        root->color = NodeColor::Black;
+    }
+};
+
+#endif
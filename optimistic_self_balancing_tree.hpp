@@ -0,0 +1,613 @@
+#ifndef OPTIMISTIC_SELF_BALANCING_TREE_HPP
+#define OPTIMISTIC_SELF_BALANCING_TREE_HPP
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace MyDataStructures {
+    // Red-black tree for one writer thread and many reader threads.
+    //
+    // The writer makes the sequence counter odd while it relinks nodes and
+    // even again once the tree is consistent. Readers never write anything
+    // the writer or other readers touch, they walk the tree optimistically
+    // and only retry if the sequence moved while they were reading.
+    //
+    // Unlinked nodes are reclaimed with epochs: each reader owns a padded
+    // slot where it publishes the epoch it started in, and the writer only
+    // frees a node once every active reader started after it was unlinked.
+    //
+    // A node's key and value never change after it is published, erase
+    // relinks the successor node instead of copying its pair, so readers
+    // can copy values out of any node they reach
+    template <typename K, typename V, std::size_t MaxReaders = 64>
+    class optimistic_self_balancing_tree {
+        enum class NodeColor {Red, Black};
+
+        // Only the child pointers are read concurrently, parent and color
+        // belong to the writer
+        struct Node {
+            NodeColor color = NodeColor::Red;
+
+            Node* parent = nullptr;
+            std::atomic<Node*> left_child{nullptr};
+            std::atomic<Node*> right_child{nullptr};
+
+            const K key;
+            const V value;
+
+            Node(K k, V v) : key(std::move(k)), value(std::move(v)) { }
+        };
+
+        struct RetiredNode {
+            Node* node;
+            std::uint64_t epoch;
+        };
+
+        // One cache line per reader, so publishing an epoch never bounces
+        // a line another reader is using. 0 means the reader is idle
+        struct alignas(64) EpochSlot {
+            std::atomic<std::uint64_t> epoch{0};
+            std::atomic<bool> claimed{false};
+        };
+
+        // A valid red-black tree holding at most 2^64 nodes is never
+        // deeper than this, a longer walk means we raced with a relink
+        static constexpr std::size_t max_depth = 2 * 64;
+
+        // Reclamation is attempted every time this many nodes are retired
+        static constexpr std::size_t reclaim_threshold = 64;
+
+        alignas(64) std::atomic<std::uint64_t> sequence{0};
+        std::atomic<Node*> root{nullptr};
+        alignas(64) std::atomic<std::uint64_t> global_epoch{1};
+        EpochSlot slots[MaxReaders];
+
+        // Writer only
+        std::size_t _size = 0;
+        std::vector<RetiredNode> retired;
+
+        static inline Node* left(const Node* N) { return N->left_child.load(std::memory_order_relaxed); }
+        static inline Node* right(const Node* N) { return N->right_child.load(std::memory_order_relaxed); }
+        static inline void set_left(Node* N, Node* C) { N->left_child.store(C, std::memory_order_release); }
+        static inline void set_right(Node* N, Node* C) { N->right_child.store(C, std::memory_order_release); }
+        inline Node* get_root() const { return root.load(std::memory_order_relaxed); }
+        inline void set_root(Node* N) { root.store(N, std::memory_order_release); }
+
+        inline void begin_write();
+        inline void end_write();
+        inline bool read_helper(const K& key, V* out) const;
+
+        inline void retire(Node* N);
+        inline void retire_helper(Node* N);
+        void destroy_helper(Node* N);
+
+        inline Node* minimum_leaf(Node* X);
+        inline void left_rotate(Node* X);
+        inline void right_rotate(Node* X);
+        inline void repair_tree_after_insert(Node* Z);
+        inline void repair_tree_after_delete(Node* Z, Node* P, bool left_child);
+        inline void transplant(Node* X, Node* Y);
+        inline void RB_BSTDelete(Node* Z);
+
+        public:
+        // Per thread handle for lookups. A reader holds one epoch slot for
+        // its whole lifetime, so create it once per thread and keep it
+        class reader {
+        public:
+            reader(reader&& R) : tree(R.tree), slot(R.slot) { R.tree = nullptr; R.slot = nullptr; }
+            reader(const reader&) = delete;
+            reader& operator=(const reader&) = delete;
+            reader& operator=(reader&&) = delete;
+
+            ~reader() {
+                if (slot != nullptr) {
+                    slot->claimed.store(false, std::memory_order_release);
+                }
+            }
+
+            // Copies the value stored under key into out
+            inline bool find(const K& key, V& out) const;
+            inline bool contains(const K& key) const;
+        private:
+            friend class optimistic_self_balancing_tree<K, V, MaxReaders>;
+
+            const optimistic_self_balancing_tree<K, V, MaxReaders>* tree;
+            EpochSlot* slot;
+
+            reader(const optimistic_self_balancing_tree<K, V, MaxReaders>* T, EpochSlot* S) : tree(T), slot(S) {};
+
+            inline void enter() const;
+            inline void exit() const;
+        };
+
+        optimistic_self_balancing_tree() {};
+        ~optimistic_self_balancing_tree();
+
+        optimistic_self_balancing_tree(const optimistic_self_balancing_tree& T) = delete;
+        optimistic_self_balancing_tree& operator=(const optimistic_self_balancing_tree& T) = delete;
+
+        // Thread safe, throws once all MaxReaders slots are in use
+        reader make_reader();
+
+        // Writer only, at most one thread may call these at a time
+        inline void insert(K elem_key, V elem_value);
+        inline void erase(const K& k);
+        inline void clear();
+        inline void reclaim();
+        inline bool empty() const;
+        inline std::size_t size() const;
+    };
+
+    template <typename K, typename V, std::size_t R>
+    optimistic_self_balancing_tree<K, V, R>::~optimistic_self_balancing_tree() {
+        // No reader may outlive the tree, so everything can go now
+        destroy_helper(get_root());
+        root.store(nullptr, std::memory_order_relaxed);
+
+        for (const RetiredNode& N : retired) {
+            delete N.node;
+        }
+        retired.clear();
+    }
+
+    template <typename K, typename V, std::size_t R>
+    typename optimistic_self_balancing_tree<K, V, R>::reader optimistic_self_balancing_tree<K, V, R>::make_reader() {
+        for (EpochSlot& S : slots) {
+            bool expected = false;
+            if (!S.claimed.load(std::memory_order_relaxed) &&
+                S.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return reader(this, &S);
+            }
+        }
+
+        throw std::overflow_error("No free reader slots.");
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::reader::enter() const {
+        // The fence keeps the tree loads from being hoisted above the epoch
+        // store, otherwise the writer could miss us and free what we read
+        slot->epoch.store(tree->global_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::reader::exit() const {
+        slot->epoch.store(0, std::memory_order_release);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline bool optimistic_self_balancing_tree<K, V, R>::reader::find(const K& key, V& out) const {
+        enter();
+        bool found = tree->read_helper(key, &out);
+        exit();
+
+        return found;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline bool optimistic_self_balancing_tree<K, V, R>::reader::contains(const K& key) const {
+        enter();
+        bool found = tree->read_helper(key, nullptr);
+        exit();
+
+        return found;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline bool optimistic_self_balancing_tree<K, V, R>::read_helper(const K& key, V* out) const {
+        while (true) {
+            std::uint64_t seq = sequence.load(std::memory_order_acquire);
+
+            // The writer is in the middle of relinking, try again
+            if (seq & 1) continue;
+
+            const Node* Z = root.load(std::memory_order_acquire);
+            std::size_t depth = 0;
+
+            while (Z != nullptr && depth++ < max_depth) {
+                if (key == Z->key) {
+                    break;
+                } else if (key < Z->key) {
+                    Z = Z->left_child.load(std::memory_order_acquire);
+                } else {
+                    Z = Z->right_child.load(std::memory_order_acquire);
+                }
+            }
+
+            // Nodes are immutable and can't be freed while we are in our
+            // epoch, so the copy is safe even if it has to be thrown away
+            if (Z != nullptr && depth <= max_depth && out != nullptr) {
+                *out = Z->value;
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (depth <= max_depth && sequence.load(std::memory_order_relaxed) == seq) {
+                return Z != nullptr;
+            }
+        }
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::begin_write() {
+        // Only the writer stores to the sequence, so a plain store is enough
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::end_write() {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::retire(Node* N) {
+        retired.push_back({N, global_epoch.load(std::memory_order_relaxed)});
+
+        if (retired.size() >= reclaim_threshold) {
+            reclaim();
+        }
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::reclaim() {
+        if (retired.empty()) return;
+
+        // Readers that publish the new epoch started after every node in
+        // the list was unlinked, so only the older readers can hold them
+        std::uint64_t epoch = global_epoch.load(std::memory_order_relaxed) + 1;
+        global_epoch.store(epoch, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::uint64_t oldest = epoch;
+        for (const EpochSlot& S : slots) {
+            std::uint64_t E = S.epoch.load(std::memory_order_acquire);
+            if (E != 0 && E < oldest) {
+                oldest = E;
+            }
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < retired.size(); i++) {
+            if (retired[i].epoch < oldest) {
+                delete retired[i].node;
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+        retired.resize(kept);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline std::size_t optimistic_self_balancing_tree<K, V, R>::size() const {
+        return _size;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline bool optimistic_self_balancing_tree<K, V, R>::empty() const {
+        return (_size == 0);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::insert(K elem_key, V elem_value) {
+        Node* curr_node = get_root();
+        Node* prev_node = nullptr;
+
+        while (curr_node != nullptr) {
+            prev_node = curr_node;
+            if (elem_key < curr_node->key) {
+                curr_node = left(curr_node);
+            } else if (elem_key > curr_node->key) {
+                curr_node = right(curr_node);
+            } else {
+                return;
+            }
+        }
+
+        // The node is filled in before the release store that links it,
+        // so a reader that finds it also sees its key and value
+        Node* new_node = new Node(std::move(elem_key), std::move(elem_value));
+        new_node->parent = prev_node;
+
+        begin_write();
+        if (prev_node == nullptr) {
+            set_root(new_node);
+        } else if (new_node->key < prev_node->key) {
+            set_left(prev_node, new_node);
+        } else {
+            set_right(prev_node, new_node);
+        }
+        repair_tree_after_insert(new_node);
+        end_write();
+
+        _size++;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::erase(const K& k) {
+        Node* curr_node = get_root();
+
+        while (curr_node != nullptr) {
+            if (curr_node->key == k) {
+                break;
+            } else if (k < curr_node->key) {
+                curr_node = left(curr_node);
+            } else {
+                curr_node = right(curr_node);
+            }
+        }
+
+        if (curr_node == nullptr) return;
+
+        begin_write();
+        RB_BSTDelete(curr_node);
+        end_write();
+
+        _size--;
+        retire(curr_node);
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::clear() {
+        Node* old_root = get_root();
+
+        begin_write();
+        set_root(nullptr);
+        end_write();
+
+        _size = 0;
+        retire_helper(old_root);
+        reclaim();
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::retire_helper(Node* N) {
+        if (N == nullptr)
+            return;
+
+        retire_helper(left(N));
+        retire_helper(right(N));
+
+        retired.push_back({N, global_epoch.load(std::memory_order_relaxed)});
+    }
+
+    template <typename K, typename V, std::size_t R>
+    void optimistic_self_balancing_tree<K, V, R>::destroy_helper(Node* N) {
+        if (N == nullptr)
+            return;
+
+        destroy_helper(left(N));
+        destroy_helper(right(N));
+
+        delete N;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline typename optimistic_self_balancing_tree<K, V, R>::Node* optimistic_self_balancing_tree<K, V, R>::minimum_leaf(Node* X) {
+        while (left(X) != nullptr) {
+            X = left(X);
+        }
+        return X;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::transplant(Node* X, Node* Y) {
+        if (X->parent == nullptr) {
+            set_root(Y);
+        } else if (X == left(X->parent)) {
+            set_left(X->parent, Y);
+        } else {
+            set_right(X->parent, Y);
+        }
+        if (Y != nullptr) Y->parent = X->parent;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::RB_BSTDelete(Node* Z) {
+        Node* X;
+        Node* P;
+        NodeColor removed_color = Z->color;
+        bool left_child;
+
+        // Unlike self_balancing_tree the successor node is moved into Z's
+        // place rather than having its pair copied into Z, readers may be
+        // looking at either node while this runs
+        if (left(Z) == nullptr || right(Z) == nullptr) {
+            X = (left(Z) != nullptr) ? left(Z) : right(Z);
+            P = Z->parent;
+            left_child = (P != nullptr && Z == left(P));
+            transplant(Z, X);
+        } else {
+            Node* Y = minimum_leaf(right(Z));
+            removed_color = Y->color;
+            X = right(Y);
+
+            if (Y->parent == Z) {
+                P = Y;
+                left_child = false;
+            } else {
+                P = Y->parent;
+                left_child = true;
+                transplant(Y, X);
+                set_right(Y, right(Z));
+                right(Y)->parent = Y;
+            }
+
+            transplant(Z, Y);
+            set_left(Y, left(Z));
+            left(Y)->parent = Y;
+            Y->color = Z->color;
+        }
+
+        if (removed_color == NodeColor::Black) {
+            repair_tree_after_delete(X, P, left_child);
+        }
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::left_rotate(Node* X) {
+        Node* Y = right(X);
+        set_right(X, left(Y));
+        if (left(Y) != nullptr) {
+            left(Y)->parent = X;
+        }
+        Y->parent = X->parent;
+        if (X->parent == nullptr) {
+            set_root(Y);
+        } else if (X == left(X->parent)) {
+            set_left(X->parent, Y);
+        } else {
+            set_right(X->parent, Y);
+        }
+        set_left(Y, X);
+        X->parent = Y;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::right_rotate(Node* X) {
+        Node* Y = left(X);
+        set_left(X, right(Y));
+        if (right(Y) != nullptr) {
+            right(Y)->parent = X;
+        }
+        Y->parent = X->parent;
+        if (X->parent == nullptr) {
+            set_root(Y);
+        } else if (X == right(X->parent)) {
+            set_right(X->parent, Y);
+        } else {
+            set_left(X->parent, Y);
+        }
+        set_right(Y, X);
+        X->parent = Y;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::repair_tree_after_delete(Node* Z, Node* P, bool left_child) {
+        Node* W;
+        while (Z != get_root() && (Z == nullptr || Z->color == NodeColor::Black)) {
+            if (left_child) {
+                W = right(P);
+                if (W != nullptr && W->color == NodeColor::Red) {
+                    W->color = NodeColor::Black;
+                    P->color = NodeColor::Red;
+                    left_rotate(P);
+                    W = right(P);
+                }
+
+                bool is_left_black = left(W) == nullptr || left(W)->color == NodeColor::Black;
+                bool is_right_black = right(W) == nullptr || right(W)->color == NodeColor::Black;
+
+                if (is_left_black && is_right_black) {
+                    W->color = NodeColor::Red;
+                    Z = P;
+                    P = P->parent;
+                    left_child = (P != nullptr && left(P) == Z);
+                } else {
+                    if (is_right_black) {
+                        left(W)->color = NodeColor::Black;
+                        W->color = NodeColor::Red;
+                        right_rotate(W);
+                        W = right(P);
+                    }
+
+                    W->color = P->color;
+                    P->color = NodeColor::Black;
+                    if (right(W) != nullptr) {
+                        right(W)->color = NodeColor::Black;
+                    }
+                    left_rotate(P);
+                    Z = get_root();
+                }
+            } else {
+                W = left(P);
+                if (W != nullptr && W->color == NodeColor::Red) {
+                    W->color = NodeColor::Black;
+                    P->color = NodeColor::Red;
+                    right_rotate(P);
+                    W = left(P);
+                }
+
+                bool is_left_black = left(W) == nullptr || left(W)->color == NodeColor::Black;
+                bool is_right_black = right(W) == nullptr || right(W)->color == NodeColor::Black;
+
+                if (is_left_black && is_right_black) {
+                    W->color = NodeColor::Red;
+                    Z = P;
+                    P = P->parent;
+                    left_child = (P != nullptr && left(P) == Z);
+                } else {
+                    if (is_left_black) {
+                        right(W)->color = NodeColor::Black;
+                        W->color = NodeColor::Red;
+                        left_rotate(W);
+                        W = left(P);
+                    }
+
+                    W->color = P->color;
+                    P->color = NodeColor::Black;
+                    if (left(W) != nullptr) {
+                        left(W)->color = NodeColor::Black;
+                    }
+                    right_rotate(P);
+                    Z = get_root();
+                }
+            }
+        }
+
+        // Erasing the last node leaves nothing to recolor
+        if (Z != nullptr) Z->color = NodeColor::Black;
+    }
+
+    template <typename K, typename V, std::size_t R>
+    inline void optimistic_self_balancing_tree<K, V, R>::repair_tree_after_insert(Node* Z) {
+        while (Z != get_root() && Z->parent->color == NodeColor::Red) {
+            Node* Y;
+            if (Z->parent == left(Z->parent->parent)) {
+                Y = right(Z->parent->parent);
+
+                if (Y != nullptr && Y->color == NodeColor::Red) {
+                    Z->parent->color = NodeColor::Black;
+                    Y->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    Z = Z->parent->parent;
+                } else {
+                    if (Z == right(Z->parent)) {
+                        Z = Z->parent;
+                        left_rotate(Z);
+                    }
+                    Z->parent->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    right_rotate(Z->parent->parent);
+                }
+
+            } else {
+                Y = left(Z->parent->parent);
+
+                if (Y != nullptr && Y->color == NodeColor::Red) {
+                    Z->parent->color = NodeColor::Black;
+                    Y->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    Z = Z->parent->parent;
+                } else {
+                    if (Z == left(Z->parent)) {
+                        Z = Z->parent;
+                        right_rotate(Z);
+                    }
+                    Z->parent->color = NodeColor::Black;
+                    Z->parent->parent->color = NodeColor::Red;
+                    left_rotate(Z->parent->parent);
+                }
+
+            }
+        }
+        get_root()->color = NodeColor::Black;
+    }
+};
+
+#endif
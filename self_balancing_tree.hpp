@@ -3,6 +3,7 @@
 
 #include <iterator>
 #include <exception>
+#include <vector>
 
 namespace MyDataStructures {
     template <typename K, typename V>
@@ -187,6 +188,7 @@ namespace MyDataStructures {
         inline void repair_tree_after_delete(Node<K, V>* Z, Node<K, V>* P, bool left_child);
         inline void transplant(Node<K, V>* X, Node<K, V>* Y);
         inline void RB_BSTDelete(Node<K, V>* Z);
+        Node<K, V>* build_balanced(Node<K, V>** nodes, size_t lo, size_t hi, Node<K, V>* P, size_t depth, size_t red_depth);
 
         public:
         self_balancing_tree() {};
@@ -206,6 +208,8 @@ namespace MyDataStructures {
         
         inline void insert(K elem_key, V elem_value);
         inline void erase(const K& k);
+        template <typename Pred> inline size_t erase_if(Pred pred);
+        template <typename Pred> inline size_t retain(Pred pred);
         inline void clear();
         inline bool empty() const;
         inline size_t size();
@@ -447,6 +451,94 @@ namespace MyDataStructures {
         _size--;
     }
 
+    template <typename K, typename V>
+    template <typename Pred>
+    inline size_t self_balancing_tree<K, V>::erase_if(Pred pred) {
+        std::vector<Node<K, V>*> kept;
+        std::vector<Node<K, V>*> removed;
+        kept.reserve(_size);
+
+        // Single inorder pass, the predicate is only called once per element
+        Node<K, V>* N = root;
+        std::vector<Node<K, V>*> stack;
+        while (N != nullptr || !stack.empty()) {
+            while (N != nullptr) {
+                stack.push_back(N);
+                N = N->left_child;
+            }
+
+            N = stack.back();
+            stack.pop_back();
+
+            if (pred(reinterpret_cast<const typename Node<K, V>::ext_pair&>(N->key_val_pair))) {
+                removed.push_back(N);
+            } else {
+                kept.push_back(N);
+            }
+
+            N = N->right_child;
+        }
+
+        if (removed.empty()) return 0;
+
+        size_t height = 0;
+        for (size_t n = _size; n > 0; n >>= 1) height++;
+
+        // Deleting one by one costs O(k log n) plus rotations, rebuilding
+        // costs O(n), so only rebuild once enough keys go away to pay for it
+        if (removed.size() * height < _size) {
+            // RB_BSTDelete can move a successor's pair into another node,
+            // so the collected pointers can't be trusted after the first erase
+            std::vector<K> keys;
+            keys.reserve(removed.size());
+            for (Node<K, V>* Z : removed) {
+                keys.push_back(Z->key_val_pair.first);
+            }
+
+            for (const K& k : keys) {
+                erase(k);
+            }
+
+            return removed.size();
+        }
+
+        for (Node<K, V>* Z : removed) {
+            delete Z;
+        }
+
+        // With the survivors split at the midpoint every level but the last
+        // is full, coloring that last level red keeps the black height equal
+        size_t full_levels = 0;
+        for (size_t n = kept.size() + 1; n > 1; n >>= 1) full_levels++;
+
+        _size = kept.size();
+        root = kept.empty() ? nullptr : build_balanced(kept.data(), 0, kept.size(), nullptr, 0, full_levels);
+
+        return removed.size();
+    }
+
+    template <typename K, typename V>
+    template <typename Pred>
+    inline size_t self_balancing_tree<K, V>::retain(Pred pred) {
+        return erase_if([&pred](const std::pair<const K, V>& kv_pair) { return !pred(kv_pair); });
+    }
+
+    template <typename K, typename V>
+    typename self_balancing_tree<K, V>::template Node<K, V>* self_balancing_tree<K, V>::build_balanced(Node<K, V>** nodes, size_t lo, size_t hi, Node<K, V>* P, size_t depth, size_t red_depth) {
+        if (lo >= hi)
+            return nullptr;
+
+        size_t mid = lo + (hi - lo) / 2;
+        Node<K, V>* Z = nodes[mid];
+
+        Z->parent = P;
+        Z->color = (depth >= red_depth) ? NodeColor::Red : NodeColor::Black;
+        Z->left_child = build_balanced(nodes, lo, mid, Z, depth + 1, red_depth);
+        Z->right_child = build_balanced(nodes, mid + 1, hi, Z, depth + 1, red_depth);
+
+        return Z;
+    }
+
     template <typename K, typename V>
     void self_balancing_tree<K, V>::destroy_helper(Node<K, V>* N) {
         if (N == nullptr)